@@ -0,0 +1,13 @@
+# PlatformIO extra script adding the `size_report` target. See size_report.py.
+Import("env")
+
+env.AddCustomTarget(
+    name="size_report",
+    dependencies="$BUILD_DIR/${PROGNAME}.elf",
+    actions=[
+        '"$PYTHONEXE" "$PROJECT_DIR/scripts/size_report.py" '
+        '"$BUILD_DIR/${PROGNAME}.elf"'
+    ],
+    title="Size Report",
+    description="Print per-symbol RAM and flash usage",
+)
@@ -0,0 +1,116 @@
+#!/usr/bin/env python3
+"""
+Print a per-symbol breakdown of RAM and flash usage for a firmware ELF.
+
+PlatformIO runs this through the `size_report` target:
+
+    pio run -t size_report
+
+It can also be run directly on an ELF:
+
+    python3 scripts/size_report.py .pio/build/uno/firmware.elf
+"""
+import argparse
+import subprocess
+import sys
+
+
+# ATmega328P with the 512-byte Optiboot bootloader
+RAM_BUDGET = 2048
+FLASH_BUDGET = 32256
+
+# Sections occupying each memory. Initialized data takes RAM and also flash for
+# its initial value.
+RAM_SECTIONS = ('.data', '.bss', '.noinit')
+FLASH_SECTIONS = ('.text', '.data')
+
+
+def read_sections(size, elf):
+    """Return {name: (address, size)} from `size -A`"""
+    output = subprocess.run(
+        [size, '-A', '-d', elf],
+        check=True, capture_output=True, text=True
+    ).stdout
+
+    sections = {}
+    for line in output.splitlines():
+        # section size address
+        parts = line.split()
+        if len(parts) == 3 and parts[0].startswith('.'):
+            sections[parts[0]] = (int(parts[2]), int(parts[1]))
+    return sections
+
+
+def read_symbols(nm, elf):
+    """Return [(name, address, size, type)] from nm"""
+    output = subprocess.run(
+        [nm, '--size-sort', '--print-size', '--demangle', '--radix=d', elf],
+        check=True, capture_output=True, text=True
+    ).stdout
+
+    symbols = []
+    for line in output.splitlines():
+        # address size type name
+        parts = line.split(maxsplit=3)
+        if len(parts) != 4:
+            continue
+        symbols.append((parts[3], int(parts[0]), int(parts[1]), parts[2]))
+    return symbols
+
+
+def in_sections(symbol, sections, names):
+    address = symbol[1]
+    return any(start <= address < start + length
+               for name, (start, length) in sections.items()
+               if name in names and length)
+
+
+def print_table(title, total, symbols, budget, top):
+    # The total comes from the section sizes. Symbols don't cover everything:
+    # string literals and alignment padding have no symbol of their own.
+    print(f'{title}: {total} of {budget} bytes ({100*total/budget:.1f}%)')
+    ranked = sorted(symbols, key=lambda s: -s[2])
+    for name, _, size, kind in ranked[:top]:
+        print(f'  {size:6d}  {kind}  {name}')
+    if len(ranked) > top:
+        rest = sum(size for _, _, size, _ in ranked[top:])
+        print(f'  {rest:6d}     ({len(ranked) - top} more symbols)')
+    unnamed = total - sum(size for _, _, size, _ in ranked)
+    if unnamed > 0:
+        print(f'  {unnamed:6d}     (no symbol: literals, padding)')
+    print()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--nm', default='avr-nm')
+    parser.add_argument('--size', default='avr-size')
+    parser.add_argument('--top', '-n', type=int, default=20)
+    parser.add_argument('--ram', type=int, default=RAM_BUDGET)
+    parser.add_argument('--flash', type=int, default=FLASH_BUDGET)
+    parser.add_argument('elf')
+    args = parser.parse_args()
+
+    sections = read_sections(args.size, args.elf)
+    symbols = read_symbols(args.nm, args.elf)
+
+    ram = sum(sections.get(name, (0, 0))[1] for name in RAM_SECTIONS)
+    flash = sum(sections.get(name, (0, 0))[1] for name in FLASH_SECTIONS)
+
+    print_table('RAM (static)', ram,
+                [s for s in symbols if in_sections(s, sections, RAM_SECTIONS)],
+                args.ram, args.top)
+    # .data symbols appear in both tables: their initial values are stored in
+    # flash and copied to RAM at startup (type D/d in the listing)
+    print_table('Flash', flash,
+                [s for s in symbols if in_sections(s, sections, FLASH_SECTIONS)],
+                args.flash, args.top)
+
+    # Whatever static data doesn't use is shared by the stack. Compare this to
+    # the stack_unused figure the firmware logs to see the real margin.
+    print(f'Left for the stack: {args.ram - ram} bytes')
+    return 0 if ram < args.ram else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
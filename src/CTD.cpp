@@ -100,28 +100,41 @@ static size_t rb_read_all(char *output) {
 }
 
 
+// Split the next comma-separated field off the line, skipping leading spaces.
+// Return NULL once the line has no fields left.
+static char *next_field(char **buf_ptr) {
+    if (!*buf_ptr)
+        return NULL;
+
+    *buf_ptr += strspn(*buf_ptr, " ");
+    return strsep(buf_ptr, ",");
+}
+
+
 static void handle_ctd_line(writefn_t writefn) {
-    // Copy the line into contiguous memory
-    char line[sizeof(LONGEST_CTD_STR)+1];
+    // Copy the line into contiguous memory. The same buffer is reused to
+    // format the averaged record, so it must have room for that too.
+    char line[CTD_RECORD_SIZE > sizeof(LONGEST_CTD_STR)+1 ?
+        CTD_RECORD_SIZE : sizeof(LONGEST_CTD_STR)+1];
     size_t len = rb_read_all(line);
     line[len] = '\0';
 
-    // Parse temperature, conductivity, and pressure
+    // Parse temperature, conductivity, and pressure. A missing field reads as
+    // zero, the same as an empty one.
     char *buf_ptr = line;
-    buf_ptr += strspn(buf_ptr, " ");
-    samples[n_samples].temperature = atof(strsep(&buf_ptr, ","));
-    buf_ptr += strspn(buf_ptr, " ");
-    samples[n_samples].conductivity = atof(strsep(&buf_ptr, ","));
-    buf_ptr += strspn(buf_ptr, " ");
-    samples[n_samples].pressure = atof(strsep(&buf_ptr, ","));
+    char *token = next_field(&buf_ptr);
+    samples[n_samples].temperature = token ? atof(token) : 0;
+    token = next_field(&buf_ptr);
+    samples[n_samples].conductivity = token ? atof(token) : 0;
+    token = next_field(&buf_ptr);
+    samples[n_samples].pressure = token ? atof(token) : 0;
 
     // If there is a fourth field, count the digits after the decimal point to
     // determine if it's salinity (sss.ssss) or sound velocity (vvvv.vvv).
     samples[n_samples].salinity = -9999;
     samples[n_samples].sound_velocity = -9999;
 
-    buf_ptr += strspn(buf_ptr, " ");
-    char *token = strsep(&buf_ptr, ",");
+    token = next_field(&buf_ptr);
     if (token) {
         char *decimal = strchr(token, '.');
         if (decimal && strspn(decimal + 1, "0123456789") == 4)
@@ -131,8 +144,7 @@ static void handle_ctd_line(writefn_t writefn) {
     }
 
     // If there is a fifth field, it must be sound velocity
-    buf_ptr += strspn(buf_ptr, " ");
-    token = strsep(&buf_ptr, ",");
+    token = next_field(&buf_ptr);
     if (token)
         samples[n_samples].sound_velocity = atof(token);
 
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <stddef.h>
 
 
@@ -6,6 +8,13 @@
 typedef size_t (*writefn_t)(const char *str);
 
 
+// Room needed to format an averaged record, including the newline and
+// terminator. Each field is cut to 8 characters, but dtostrf() first writes
+// the whole value, and the -9999 placeholders for missing fields are wider.
+#define CTD_RECORD_SIZE \
+    sizeof("ttt.tttt, cc.ccccc, pppp.ppp, -9999.0000, -9999.000\n")
+
+
 /*
 Parse a serial string from the Sea-Bird SBE 49 FastCAT CTD.
 
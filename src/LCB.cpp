@@ -0,0 +1,196 @@
+#include <string.h>
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/power.h>
+#include <util/atomic.h>
+
+#include "LCB.h"
+
+
+// How many averaged records can wait for a send slot. At steady state there is
+// one; the second covers a record arriving while the previous one is still
+// being transmitted.
+#define QUEUE_LEN 2
+
+// Largest adjustment to a single period, in ticks. The OpenLog is clocked by a
+// ceramic resonator, so allow for up to 0.5% disagreement with the CTD.
+#define TRIM_MAX (LCB_TICKS_PER_SEC / 200)
+
+// After this many slots in a row with nothing to send, assume the CTD has
+// stopped and let the next record set the phase again
+#define RELOCK_MISSED 3
+
+
+static char queue[QUEUE_LEN][CTD_RECORD_SIZE];
+static uint32_t queued_at[QUEUE_LEN];
+static volatile uint8_t q_head = 0;
+static volatile uint8_t q_count = 0;
+
+// Next byte to transmit, or NULL if the UART is idle
+static const char * volatile tx_ptr = NULL;
+
+// Ticks at the start of the current period, and the adjustment to apply to the
+// next one
+static volatile uint32_t tick_base = 0;
+static volatile int16_t trim = 0;
+
+static uint16_t phase_ticks;
+static volatile uint8_t phase_locked = 0;
+static uint8_t missed_in_row = 0;
+
+static volatile struct lcb_stats stats;
+
+
+void lcb_begin(uint16_t phase_ms) {
+    phase_ticks = (uint32_t)phase_ms * LCB_TICKS_PER_SEC / 1000;
+
+    power_timer1_enable();
+
+    // CTC mode on OCR1A with a /256 prescaler, interrupting every period
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12) | _BV(CS12);
+    OCR1A = LCB_TICKS_PER_SEC - 1;
+    TCNT1 = 0;
+    TIFR1 = _BV(OCF1A);
+    TIMSK1 = _BV(OCIE1A);
+}
+
+
+size_t lcb_enqueue(const char *record) {
+    size_t len = strlen(record);
+    if (len >= CTD_RECORD_SIZE)
+        len = CTD_RECORD_SIZE - 1;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // Where in the period this record landed, relative to where we want
+        // it: phase_ticks before the next slot.
+        uint16_t pos = TCNT1;
+        uint16_t target = (OCR1A + 1) - phase_ticks;
+        int32_t error = (int32_t)pos - target;
+        if (error > (int32_t)LCB_TICKS_PER_SEC / 2)
+            error -= LCB_TICKS_PER_SEC;
+        else if (error < -(int32_t)LCB_TICKS_PER_SEC / 2)
+            error += LCB_TICKS_PER_SEC;
+
+        if (!phase_locked) {
+            // Jump the timer so the first slot is exactly phase_ticks away,
+            // keeping lcb_ticks() continuous across the jump
+            tick_base += (int32_t)pos - target;
+            TCNT1 = target;
+            phase_locked = 1;
+        } else {
+            // Lengthen the next period if records are arriving late in it,
+            // shorten it if they arrive early
+            error /= 8;
+            if (error > TRIM_MAX)
+                error = TRIM_MAX;
+            else if (error < -TRIM_MAX)
+                error = -TRIM_MAX;
+            trim = error;
+        }
+
+        uint8_t slot;
+        if (q_count < QUEUE_LEN) {
+            slot = (q_head + q_count) % QUEUE_LEN;
+            q_count ++;
+        } else if (tx_ptr) {
+            // The head is on the wire, so replace the record waiting behind it
+            slot = (q_head + q_count - 1) % QUEUE_LEN;
+            stats.dropped ++;
+        } else {
+            // Drop the oldest record
+            slot = q_head;
+            q_head = (q_head + 1) % QUEUE_LEN;
+            stats.dropped ++;
+        }
+
+        memcpy(queue[slot], record, len);
+        queue[slot][len] = '\0';
+        queued_at[slot] = lcb_ticks();
+    }
+
+    return len;
+}
+
+
+uint32_t lcb_ticks(void) {
+    uint32_t base;
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        base = tick_base;
+        count = TCNT1;
+
+        // If the timer has wrapped but the compare interrupt has not run yet,
+        // the period it completed is not in tick_base
+        if ((TIFR1 & _BV(OCF1A)) && count < OCR1A / 2)
+            base += (uint32_t)OCR1A + 1;
+    }
+
+    return base + count;
+}
+
+
+void lcb_read_stats(struct lcb_stats *out, uint8_t reset) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        memcpy(out, (const void *)&stats, sizeof(*out));
+        if (reset)
+            memset((void *)&stats, 0, sizeof(stats));
+    }
+}
+
+
+// Send slot
+ISR(TIMER1_COMPA_vect) {
+    tick_base += (uint32_t)OCR1A + 1;
+    OCR1A = LCB_TICKS_PER_SEC - 1 + trim;
+
+    if (tx_ptr) {
+        stats.late ++;
+        return;
+    }
+
+    if (!q_count) {
+        stats.missed ++;
+        if (++ missed_in_row >= RELOCK_MISSED) {
+            phase_locked = 0;
+            trim = 0;
+        }
+        return;
+    }
+
+    missed_in_row = 0;
+
+    // Start transmitting. The remaining bytes are sent from USART_UDRE_vect.
+    tx_ptr = queue[q_head];
+    UDR0 = *tx_ptr++;
+    UCSR0B |= _BV(UDRIE0);
+
+    uint16_t jitter = TCNT1;
+    uint32_t age = tick_base + jitter - queued_at[q_head];
+
+    stats.sent ++;
+    if (jitter > stats.jitter_max)
+        stats.jitter_max = jitter;
+    stats.age_sum += age;
+    if (age > stats.age_max)
+        stats.age_max = age;
+}
+
+
+// UART ready for the next byte of the record being sent
+ISR(USART_UDRE_vect) {
+    char c = *tx_ptr;
+    if (c) {
+        UDR0 = c;
+        tx_ptr ++;
+        return;
+    }
+
+    // Finished: release the slot
+    UCSR0B &= ~_BV(UDRIE0);
+    tx_ptr = NULL;
+    q_head = (q_head + 1) % QUEUE_LEN;
+    q_count --;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "CTD.h"
+
+
+// Timer1 runs from F_CPU/256, so one tick is 16 us on the 16 MHz OpenLog.
+#define LCB_TICKS_PER_SEC (F_CPU / 256)
+
+#define LCB_TICKS_TO_US(t) ((uint32_t)(t) * (1000000UL / LCB_TICKS_PER_SEC))
+#define LCB_TICKS_TO_MS(t) (LCB_TICKS_TO_US(t) / 1000)
+
+
+/*
+Scheduled output to the Lander Control Board.
+
+Averaged records are not written to the UART when they are produced. Instead
+lcb_enqueue() stores them in a small queue, and a Timer1 compare interrupt
+starts sending the oldest one once per second. The bytes are fed to the UART
+from the data register empty interrupt, so neither the send time nor its
+duration depends on what the receive loop is doing (e.g. waiting on the SD
+card).
+
+The first record sets the phase of the schedule: slots fall phase_ms after
+records arrive. While the schedule is locked, every record trims the period
+slightly so the schedule follows the CTD clock rather than drifting against it.
+If several slots in a row pass with nothing to send, the CTD is assumed to have
+stopped, and the next record sets the phase again.
+
+SerialPort must be built with BUFFERED_TX disabled, because this module owns
+the USART_UDRE interrupt.
+*/
+void lcb_begin(uint16_t phase_ms);
+
+
+// Queue an averaged record for the next send slot. Matches writefn_t so it can
+// be passed straight to handle_ctd_input().
+size_t lcb_enqueue(const char *record);
+
+
+// Monotonic time in Timer1 ticks since lcb_begin()
+uint32_t lcb_ticks(void);
+
+
+struct lcb_stats {
+    uint16_t sent;
+    uint16_t dropped;       // replaced by a newer record before being sent
+    uint16_t missed;        // slots with nothing queued
+    uint16_t late;          // slots skipped because the UART was still busy
+    uint16_t jitter_max;    // ticks from the scheduled slot to the first byte
+    uint32_t age_sum;       // ticks from enqueue to first byte, summed
+    uint32_t age_max;
+};
+
+
+// Copy the delivery statistics, optionally resetting them afterward
+void lcb_read_stats(struct lcb_stats *out, uint8_t reset);
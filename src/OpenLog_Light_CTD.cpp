@@ -30,6 +30,8 @@
 #include <FreeStack.h> //Allows us to print the available stack/RAM size
 
 #include "CTD.h"
+#include "LCB.h"
+#include "Stack.h"
 
 SerialPort<0, 512, 0> NewSerial;
 //This is a very important buffer declaration. This sets the <port #, rx size, tx size>. We set
@@ -49,9 +51,20 @@ SerialPort<0, 512, 0> NewSerial;
 //#define RAM_TESTING  1 //On
 #define RAM_TESTING  0 //Off
 
+//Periodically write a comment line ("# ...") with timing statistics into the log file
+#define STATS_LOGGING  1
+#define STATS_INTERVAL_SEC  60 //Seconds between statistics lines
+
+//While data is streaming in, sync the log file at least this often
+#define SYNC_INTERVAL_SEC  60
+
+//Averaged records are sent to the Lander Control Board this long after they are produced. This leaves
+//room for SD card stalls in the receive loop without the send time moving.
+#define LCB_PHASE_MS  250
+
 #define CFG_FILENAME "config.txt" //This is the name of the file that contains the unit settings
 
-#define MAX_CFG "115200" //= 115200 bps
+#define MAX_CFG "115200,65534,1080" //= 115200 bps, rotate at 65534 KB or 1080 minutes
 #define CFG_LENGTH (strlen(MAX_CFG) + 1) //Length of text found in config file
 
 //Internal EEPROM locations for the user settings
@@ -61,11 +74,21 @@ SerialPort<0, 512, 0> NewSerial;
 #define LOCATION_BAUD_SETTING_HIGH	0x09
 #define LOCATION_BAUD_SETTING_MID	0x0A
 #define LOCATION_BAUD_SETTING_LOW	0x0B
+#define LOCATION_ROTATE_KB_LSB		0x0C
+#define LOCATION_ROTATE_KB_MSB		0x0D
+#define LOCATION_ROTATE_MIN_LSB		0x0E
+#define LOCATION_ROTATE_MIN_MSB		0x0F
 
 #define BAUD_MIN  300
 #define BAUD_DEFAULT 9600
 #define BAUD_MAX  1000000
 
+//Start a new log file once the current one reaches this size or age. Zero disables either limit.
+#define ROTATE_KB_DEFAULT  4096
+#define ROTATE_MIN_DEFAULT  60
+#define ROTATE_KB_MAX  65534 //0xFFFF in EEPROM means the setting was never written
+#define ROTATE_MIN_MAX  1080 //lcb_ticks() wraps after about 19 hours
+
 //STAT1 is a general LED and indicates serial traffic
 #define STAT1  5 //On PORTD
 #define STAT1_PORT  PORTD
@@ -88,24 +111,29 @@ const byte statled2 = 13; //This is the SPI LED, indicating SD traffic
 SdFat sd;
 
 long setting_uart_speed; //This is the baud rate that the system runs at
+uint16_t setting_rotate_kb; //Log file size, in KB, at which a new file is started
+uint16_t setting_rotate_min; //Log file age, in minutes, at which a new file is started
+
+#if STATS_LOGGING
+uint32_t asleepTicks = 0; //Time spent sleeping since statistics were last logged
+#endif
 
 //Forward declarations
-void serial_out(const char* str);
 void systemError(byte error_type);
-char* newlog(void);
-byte append_file(char* file_name);
+boolean newlog(SdFile* newFile);
+boolean rotation_due(SdFile* file, uint32_t age, uint32_t maxBytes, uint32_t maxTicks);
+byte append_file(void);
+#if STATS_LOGGING
+void log_stats(SdFile* file, char* buffer, byte size, uint32_t elapsed);
+#endif
 void blink_error(byte ERROR_TYPE);
 void read_system_settings(void);
 void read_config_file(void);
 void record_config_file(void);
 void writeBaud(long uartRate);
 long readBaud(void);
-
-
-//Wrapper around NewSerial::write() that can be passed to the CTD handler.
-void serial_out(const char* str) {
-  NewSerial.write(str);
-}
+void writeRotation(uint16_t rotateKB, uint16_t rotateMin);
+void readRotation(uint16_t* rotateKB, uint16_t* rotateMin);
 
 
 //Handle errors by printing the error type and blinking LEDs in certain way
@@ -142,7 +170,7 @@ void setup(void)
   set_sleep_mode(SLEEP_MODE_IDLE);
   sleep_enable();
 
-  //Shut off TWI, Timer2, Timer1, ADC
+  //Shut off TWI, Timer2, Timer1, ADC. Timer1 is turned back on by lcb_begin() to drive the LCB output schedule.
   ADCSRA &= ~(1<<ADEN); //Disable ADC
   ACSR = (1<<ACD); //Disable the analog comparator
   DIDR0 = 0x3F; //Disable digital input buffers on all ADC0-ADC5 pins
@@ -176,25 +204,27 @@ void setup(void)
     UBRR0 = (F_CPU / (16UL * setting_uart_speed)) - 1;
     UCSR0A &= ~_BV(U2X0);
   }
+
+  //Start the once-per-second output schedule to the Lander Control Board
+  lcb_begin(LCB_PHASE_MS);
 }
 
 void loop(void)
 {
-  append_file(newlog()); //Append the file name that newlog() returns
+  append_file(); //Log to a new file
   while(1); //We should never get this far
 }
 
 //Log to a new file everytime the system boots
 //Checks the spots in EEPROM for the next available LOG# file name
-//Updates EEPROM and then appends to the new log file.
+//Updates EEPROM and opens the new log file for appending in newFile.
 //Limited to 65535 files but this should not always be the case.
-char* newlog(void)
+//Returns false if no file could be opened
+boolean newlog(SdFile* newFile)
 {
   byte msb, lsb;
   uint16_t new_file_number;
 
-  SdFile newFile; //This will contain the file for SD writing
-
   //Combine two 8-bit EEPROM spots into one 16-bit number
   lsb = EEPROM.read(LOCATION_FILE_NUMBER_LSB);
   msb = EEPROM.read(LOCATION_FILE_NUMBER_MSB);
@@ -219,30 +249,28 @@ char* newlog(void)
   {
     //Gracefully drop out to command prompt with some error
     //NewSerial.print(F("!Too many logs:1!"));
-    return(0); //Bail!
+    return(false); //Bail!
   }
 
   //If we made it this far, everything looks good - let's start testing to see if our file number is the next available
 
   //Search for next available log spot
-  //char new_file_name[] = "LOG00000.TXT";
-  static char new_file_name[13];
+  //The file is opened straight into the caller's SdFile and left open, so logging to it needs no second open
+  //O_APPEND - seek to the end of the file prior to each write
+  //O_WRITE - open for write
+  char new_file_name[13];
   while(1)
   {
     sprintf_P(new_file_name, PSTR("LOG%05d.TXT"), new_file_number); //Splice the new file number into this file name
 
-    //Try to open file, if fail (file doesn't exist), then break
-    if (newFile.open(new_file_name, O_CREAT | O_EXCL | O_WRITE)) break;
+    //Try to create the file, if it succeeds (file didn't exist), then break
+    if (newFile->open(new_file_name, O_CREAT | O_EXCL | O_APPEND | O_WRITE)) break;
 
     //Try to open file and see if it is empty. If so, use it.
-    if (newFile.open(new_file_name, O_READ)) 
+    if (newFile->open(new_file_name, O_APPEND | O_WRITE))
     {
-      if (newFile.fileSize() == 0)
-      {
-        newFile.close();        // Close this existing file we just opened.
-        return(new_file_name);  // Use existing empty file.
-      }
-      newFile.close(); // Close this existing file we just opened.
+      if (newFile->fileSize() == 0) break; // Use existing empty file.
+      newFile->close(); // Close this existing file we just opened.
     }
 
     //Try the next number
@@ -250,10 +278,13 @@ char* newlog(void)
     if(new_file_number > 65533) //There is a max of 65534 logs
     {
       //NewSerial.print(F("!Too many logs:2!"));
-      return(0); //Bail!
+      return(false); //Bail!
     }
   }
-  newFile.close(); //Close this new file we just opened
+
+  //This is a trick to make sure first cluster is allocated - found in Bill's example/beta code
+  newFile->rewind();
+  newFile->sync();
 
   new_file_number++; //Increment so the next power up uses the next file #
 
@@ -271,38 +302,57 @@ char* newlog(void)
   //NewSerial.println(new_file_name);
 #endif
 
-  //  append_file(new_file_name);
-  return(new_file_name);
+  return(true);
+}
+
+//Checks whether a log file has reached a size in bytes or an age in ticks. A limit of zero is never reached.
+boolean rotation_due(SdFile* file, uint32_t age, uint32_t maxBytes, uint32_t maxTicks)
+{
+  if (maxBytes && file->fileSize() >= maxBytes) return(true);
+  if (maxTicks && age >= maxTicks) return(true);
+  return(false);
 }
 
 //This is the most important function of the device. These loops have been tweaked as much as possible.
 //Modifying this loop may negatively affect how well the device can record at high baud rates.
-//Appends a stream of serial data to a given file
+//Appends a stream of serial data to a new log file
 //Assumes the currentDirectory variable has been set before entering the routine
 //Returns 0 on error
 //Returns 1 on success
-byte append_file(char* file_name)
+byte append_file(void)
 {
-  SdFile workingFile;
-
-  // O_CREAT - create the file if it does not exist
-  // O_APPEND - seek to the end of the file prior to each write
-  // O_WRITE - open for write
-  if (!workingFile.open(file_name, O_CREAT | O_APPEND | O_WRITE)) systemError(ERROR_FILE_OPEN);
-
-  if (workingFile.fileSize() == 0) {
-    //This is a trick to make sure first cluster is allocated - found in Bill's example/beta code
-    workingFile.rewind();
-    workingFile.sync();
-  }
-
-  //This is the 2nd buffer. It pulls from the larger Serial buffer as quickly as possible.
-  //The built-in Arduino serial buffer is 64 bytes: https://www.arduino.cc/en/Serial/Available
+  //The log is rotated between two files: the one being written, and the next one, which is created
+  //ahead of time while the receive loop is idle so switching to it doesn't stall
+  SdFile logFiles[2];
+  SdFile* workingFile = &logFiles[0];
+  SdFile* nextFile = &logFiles[1];
+  boolean nextReady = false; //True once nextFile has been created
+  boolean createNext = false; //True when nextFile should be created at the next idle moment
+
+  //The rotation limits don't change while logging, so convert them to bytes and ticks once. The half way
+  //points are when the next file gets created.
+  uint32_t rotateBytes = (uint32_t)setting_rotate_kb * 1024;
+  uint32_t rotateTicks = (uint32_t)setting_rotate_min * 60 * LCB_TICKS_PER_SEC;
+  uint32_t precreateBytes = rotateBytes / 2;
+  uint32_t precreateTicks = rotateTicks / 2;
+
+  if (!newlog(workingFile)) systemError(ERROR_FILE_OPEN);
+
+  //This is the 2nd buffer. Characters collect here until a whole line has arrived, then the line is
+  //parsed and recorded in one burst. In between, the CPU sleeps and is woken by each received character.
   const byte LOCAL_BUFF_SIZE = 128;
   byte localBuffer[LOCAL_BUFF_SIZE];
+  byte bufferedChars = 0; //Number of characters waiting in localBuffer
+
+  const uint32_t MAX_IDLE_TICKS = LCB_TICKS_PER_SEC / 2; //Sync the card once idle this long. Only the 1 Hz LCB interrupt wakes us when input stops, so this happens 0.5-1.5 s after the last character
+  uint32_t lastRxTime = lcb_ticks(); //Keeps track of the last time characters were received
+  uint32_t lastSyncTime = lastRxTime; //Keeps track of the last time the file was synced
+  boolean unsynced = false; //True if data has been written since the last sync
+  uint32_t fileStartTime = lastRxTime; //Keeps track of when the current file was started
 
-  const unsigned int MAX_IDLE_TIME_MSEC = 500; //The number of milliseconds before unit goes to sleep
-  unsigned long lastSyncTime = millis(); //Keeps track of the last time the file was synced
+#if STATS_LOGGING
+  uint32_t lastStatsTime = lastRxTime; //Keeps track of the last time statistics were logged
+#endif
 
 #if DEBUG
   //NewSerial.print(F("FreeStack: "));
@@ -315,38 +365,201 @@ byte append_file(char* file_name)
   //Start recording incoming characters
   while(1) { //Infinite loop
 
-    byte charsToRecord = NewSerial.read(localBuffer, sizeof(localBuffer)); //Read characters from global buffer into the local buffer
-    if (charsToRecord > 0) {
+    byte charsRead = NewSerial.read(localBuffer + bufferedChars, sizeof(localBuffer) - bufferedChars); //Read characters from global buffer into the local buffer
+    if (charsRead > 0) {
+      lastRxTime = lcb_ticks();
+
+      boolean endOfLine = memchr(localBuffer + bufferedChars, '\n', charsRead) != NULL;
+      bufferedChars += charsRead;
+
+      //Go back to sleep until the rest of the line arrives
+      if (!endOfLine && bufferedChars < sizeof(localBuffer)) continue;
+
       //Scan the local buffer for esacape characters
       //In the light version of OpenLog, we don't check for escape characters
 
       //Modification for Inkfish CTD logger
-      handle_ctd_input(serial_out, localBuffer, charsToRecord);
-
-      workingFile.write(localBuffer, charsToRecord); //Record the buffer to the card
+      handle_ctd_input(lcb_enqueue, (char*)localBuffer, bufferedChars);
+
+      //Record the buffer to the card. SdFat collects it in its block cache and only writes to the card
+      //when a full 512-byte sector is ready.
+      uint16_t toSectorEnd = 512 - workingFile->curPosition() % 512;
+      if (lastRxTime - lastSyncTime >= SYNC_INTERVAL_SEC * LCB_TICKS_PER_SEC && toSectorEnd <= bufferedChars) {
+        //The CTD may never go quiet, so also sync periodically. Split the write at the sector boundary and
+        //sync there: the full sector has just gone to the card, so the sync only updates the directory entry.
+        workingFile->write(localBuffer, toSectorEnd);
+        workingFile->sync();
+        workingFile->write(localBuffer + toSectorEnd, bufferedChars - toSectorEnd);
+        lastSyncTime = lastRxTime;
+      }
+      else
+        workingFile->write(localBuffer, bufferedChars);
+      unsynced = true;
 
       STAT1_PORT ^= (1<<STAT1); //Toggle the STAT1 LED each time we record the buffer
+
+      //Check this now: the statistics and rotation lines below are formatted into localBuffer
+      boolean endsLine = localBuffer[bufferedChars - 1] == '\n';
+
+#if STATS_LOGGING
+      //Only insert statistics between CTD lines, never in the middle of one
+      if (endsLine &&
+          lastRxTime - lastStatsTime >= STATS_INTERVAL_SEC * LCB_TICKS_PER_SEC) {
+        log_stats(workingFile, (char*)localBuffer, sizeof(localBuffer), lastRxTime - lastStatsTime);
+        lastStatsTime = lastRxTime;
+      }
+#endif
+
+      //Switch to a new file between CTD lines once this one is big or old enough
+      if (endsLine && rotation_due(workingFile, lastRxTime - fileStartTime, rotateBytes, rotateTicks)) {
+        uint32_t rotateStart = lcb_ticks();
+        boolean precreated = nextReady;
+
+        //Normally the next file already exists. If it doesn't, create it now and take the stall.
+        if (!nextReady) nextReady = newlog(nextFile);
+
+        if (nextReady) {
+          workingFile->close(); //Close also syncs the file
+
+          SdFile* previousFile = workingFile;
+          workingFile = nextFile;
+          nextFile = previousFile;
+          nextReady = false;
+          fileStartTime = lastRxTime;
+
+          //Record how long the switch held up the receive loop at the top of the new file
+          int len = snprintf_P(
+            (char*)localBuffer,
+            sizeof(localBuffer),
+            PSTR("# rotate latency_us=%lu precreated=%u\n"),
+            LCB_TICKS_TO_US(lcb_ticks() - rotateStart),
+            precreated
+          );
+          workingFile->write(localBuffer, len);
+        }
+        else {
+          //Out of file numbers, or the card is full. Keep appending to the current file.
+          rotateBytes = rotateTicks = precreateBytes = precreateTicks = 0;
+        }
+      }
+
+      //Once the file is half way to rotation, create the next one the next time the loop is idle. Waiting
+      //until then means a reboot rarely leaves an unused empty file behind.
+      if (endsLine && !nextReady && rotation_due(workingFile, lastRxTime - fileStartTime, precreateBytes, precreateTicks))
+        createNext = true;
+
+      bufferedChars = 0;
     }
     //No characters recevied?
-    else if( (millis() - lastSyncTime) > MAX_IDLE_TIME_MSEC) { //If we haven't received any characters in 2s, goto sleep
-      workingFile.sync(); //Sync the card before we go to sleep
+    else {
+      if ((unsynced || bufferedChars > 0) && (lcb_ticks() - lastRxTime) > MAX_IDLE_TICKS) { //If we haven't received any characters in 500ms, sync
+        //The CTD stopped part way through a line. Record what did arrive so the sync covers it; the CTD
+        //handler keeps the partial line until the rest comes in.
+        if (bufferedChars > 0) {
+          handle_ctd_input(lcb_enqueue, (char*)localBuffer, bufferedChars);
+          workingFile->write(localBuffer, bufferedChars);
+          bufferedChars = 0;
+        }
+
+        workingFile->sync(); //Sync the card while the CTD is quiet
+        unsynced = false;
+        lastSyncTime = lcb_ticks();
+
+        STAT1_PORT &= ~(1<<STAT1); //Turn off stat LED to save power
+      }
 
-      STAT1_PORT &= ~(1<<STAT1); //Turn off stat LED to save power
+      //Use the idle time to create the next log file, so rotating to it doesn't stall
+      if (createNext) {
+        createNext = false;
+        nextReady = newlog(nextFile);
+        if (!nextReady) {
+          //Out of file numbers, or the card is full. Keep appending to the current file.
+          rotateBytes = rotateTicks = precreateBytes = precreateTicks = 0;
+        }
+      }
 
       power_timer0_disable(); //Shut down peripherals we don't need
       power_spi_disable();
-      sleep_mode(); //Stop everything and go to sleep. Wake up if serial character received
+
+#if STATS_LOGGING
+      uint32_t sleepStart = lcb_ticks();
+#endif
+
+      //Stop everything and go to sleep. Wake up on the next interrupt: a serial character received, or the
+      //Lander Control Board output schedule. Interrupts stay off from the check until the sleep instruction
+      //so a character arriving in between can't leave us asleep.
+      cli();
+      if (!NewSerial.available()) {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+      }
+      sei();
+
+#if STATS_LOGGING
+      asleepTicks += lcb_ticks() - sleepStart;
+#endif
 
       power_spi_enable(); //After wake up, power up peripherals
       power_timer0_enable();
-
-      lastSyncTime = millis(); //Reset the last sync time to now
     }
   }
 
   return(1); //Success!
 }
 
+#if STATS_LOGGING
+//Writes comment lines with the output timing, power and RAM statistics to the log file, then resets them
+//The caller lends a scratch buffer so this doesn't need more stack, and says how many ticks the statistics cover
+void log_stats(SdFile* file, char* buffer, byte size, uint32_t elapsed)
+{
+  struct lcb_stats stats;
+  lcb_read_stats(&stats, true);
+
+  int len = snprintf_P(
+    buffer,
+    size,
+    PSTR("# lcb sent=%u dropped=%u missed=%u late=%u jitter_max_us=%lu age_mean_ms=%lu age_max_ms=%lu\n"),
+    stats.sent,
+    stats.dropped,
+    stats.missed,
+    stats.late,
+    LCB_TICKS_TO_US(stats.jitter_max),
+    stats.sent ? LCB_TICKS_TO_MS(stats.age_sum / stats.sent) : 0UL,
+    LCB_TICKS_TO_MS(stats.age_max)
+  );
+  if (len >= size) len = size - 1;
+
+  file->write(buffer, len);
+
+  //Share of the interval the CPU was awake rather than sleeping in IDLE
+  len = snprintf_P(
+    buffer,
+    size,
+    PSTR("# power awake_ms=%lu asleep_ms=%lu\n"),
+    LCB_TICKS_TO_MS(elapsed - asleepTicks),
+    LCB_TICKS_TO_MS(asleepTicks)
+  );
+  if (len >= size) len = size - 1;
+  asleepTicks = 0;
+
+  file->write(buffer, len);
+
+  //Closest the stack has come to static RAM since boot, and how far it is right now
+  len = snprintf_P(
+    buffer,
+    size,
+    PSTR("# ram stack_unused=%u free_now=%d\n"),
+    stack_unused(),
+    FreeStack()
+  );
+  if (len >= size) len = size - 1;
+
+  file->write(buffer, len);
+}
+#endif
+
 //The following are system functions needed for basic operation
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
@@ -375,6 +588,15 @@ void read_system_settings(void)
     setting_uart_speed = BAUD_DEFAULT;
     writeBaud(setting_uart_speed); //Record to EEPROM
   }
+
+  //Read the log rotation limits
+  readRotation(&setting_rotate_kb, &setting_rotate_min);
+  if(setting_rotate_kb == 0xFFFF || setting_rotate_min > ROTATE_MIN_MAX) //Un-initialized or out of range
+  {
+    setting_rotate_kb = ROTATE_KB_DEFAULT;
+    setting_rotate_min = ROTATE_MIN_DEFAULT;
+    writeRotation(setting_rotate_kb, setting_rotate_min); //Record to EEPROM
+  }
 }
 
 void read_config_file(void)
@@ -420,11 +642,13 @@ void read_config_file(void)
 
   //Default the system settings in case things go horribly wrong
   long new_system_baud = BAUD_DEFAULT;
+  uint16_t new_rotate_kb = setting_rotate_kb;
+  uint16_t new_rotate_min = setting_rotate_min;
 
   //Parse the settings out
   byte i = 0, j = 0, setting_number = 0;
   char new_setting[8]; //Max length of a setting is 6, the bps setting = '115200' plus '\0'
-  byte new_setting_int = 0;
+  long new_setting_int = 0;
 
   for(i = 0 ; i < len; i++)
   {
@@ -437,7 +661,11 @@ void read_config_file(void)
     }
 
     new_setting[j] = '\0'; //Terminate the string for array compare
-    new_setting_int = atoi(new_setting); //Convert string to int
+
+    //Older config files stop after the baud rate and go straight to the decoder line
+    if(!isdigit(new_setting[0])) break;
+
+    new_setting_int = atol(new_setting); //Convert string to int
 
     if(setting_number == 0) //Baud rate
     {
@@ -446,6 +674,20 @@ void read_config_file(void)
       //Basic error checking
       if(new_system_baud < BAUD_MIN || new_system_baud > BAUD_MAX) new_system_baud = BAUD_DEFAULT;
     }
+    else if(setting_number == 1) //Rotation size in KB
+    {
+      new_rotate_kb = new_setting_int;
+
+      //Basic error checking
+      if(new_setting_int < 0 || new_setting_int > ROTATE_KB_MAX) new_rotate_kb = ROTATE_KB_DEFAULT;
+    }
+    else if(setting_number == 2) //Rotation age in minutes
+    {
+      new_rotate_min = new_setting_int;
+
+      //Basic error checking
+      if(new_setting_int < 0 || new_setting_int > ROTATE_MIN_MAX) new_rotate_min = ROTATE_MIN_DEFAULT;
+    }
     else
       //We're done! Stop looking for settings
       break;
@@ -466,6 +708,17 @@ void read_config_file(void)
     recordNewSettings = true;
   }
 
+  if(new_rotate_kb != setting_rotate_kb || new_rotate_min != setting_rotate_min) {
+    writeRotation(new_rotate_kb, new_rotate_min); //Write the rotation limits to EEPROM
+    setting_rotate_kb = new_rotate_kb;
+    setting_rotate_min = new_rotate_min;
+
+    recordNewSettings = true;
+  }
+
+  //Rewrite config files from older firmware so they show the rotation settings
+  if(setting_number < 3) recordNewSettings = true;
+
   //We don't want to constantly record a new config file on each power on. Only record when there is a change.
   if(recordNewSettings == true)
     record_config_file(); //If we corrected some values because the config file was corrupt, then overwrite any corruption
@@ -496,8 +749,10 @@ void record_config_file(void)
   snprintf_P(
     settings_string,
     sizeof(settings_string),
-    PSTR("%ld"),
-    setting_uart_speed
+    PSTR("%ld,%u,%u"),
+    setting_uart_speed,
+    setting_rotate_kb,
+    setting_rotate_min
   );
 
   //Record current system settings to the config file
@@ -507,7 +762,7 @@ void record_config_file(void)
   myFile.println(); //Add a break between lines
 
   //Add a decoder line to the file
-  myFile.write("baud");
+  myFile.write("baud,rotate_kb,rotate_min");
 
   myFile.sync(); //Sync all newly written data to card
   myFile.close(); //Close this file
@@ -534,6 +789,22 @@ long readBaud(void)
   return(uartSpeed); 
 }
 
+//Record the log rotation limits to EEPROM
+void writeRotation(uint16_t rotateKB, uint16_t rotateMin)
+{
+  EEPROM.write(LOCATION_ROTATE_KB_LSB, (byte)rotateKB);
+  EEPROM.write(LOCATION_ROTATE_KB_MSB, (byte)(rotateKB >> 8));
+  EEPROM.write(LOCATION_ROTATE_MIN_LSB, (byte)rotateMin);
+  EEPROM.write(LOCATION_ROTATE_MIN_MSB, (byte)(rotateMin >> 8));
+}
+
+//Look up the log rotation limits. Each is two bytes combined into one 16-bit number
+void readRotation(uint16_t* rotateKB, uint16_t* rotateMin)
+{
+  *rotateKB = ((uint16_t)EEPROM.read(LOCATION_ROTATE_KB_MSB) << 8) | EEPROM.read(LOCATION_ROTATE_KB_LSB);
+  *rotateMin = ((uint16_t)EEPROM.read(LOCATION_ROTATE_MIN_MSB) << 8) | EEPROM.read(LOCATION_ROTATE_MIN_LSB);
+}
+
 
 //End core system functions
 //=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -0,0 +1,49 @@
+#include <avr/io.h>
+
+#include "Stack.h"
+
+
+#define STACK_CANARY 0xC5
+
+// Turn a macro's value into a string literal, for pasting into assembly
+#define STR_(x) #x
+#define STR(x) STR_(x)
+
+
+// Provided by the linker: the end of .bss and the initial stack pointer
+extern uint8_t _end;
+extern uint8_t __stack;
+
+
+// Runs from .init1, before the stack pointer and the zero register are set up,
+// so it is written entirely in assembly and must not be called. GCC only allows
+// basic asm (no operands) in a naked function.
+void stack_paint(void) __attribute__((naked, used, section(".init1")));
+
+void stack_paint(void) {
+    __asm volatile (
+        "    ldi r30, lo8(_end)\n"
+        "    ldi r31, hi8(_end)\n"
+        "    ldi r24, " STR(STACK_CANARY) "\n"
+        "    ldi r25, hi8(__stack)\n"
+        "    rjmp 2f\n"
+        "1:  st Z+, r24\n"
+        "2:  cpi r30, lo8(__stack)\n"
+        "    cpc r31, r25\n"
+        "    brlo 1b\n"
+        "    breq 1b\n"
+    );
+}
+
+
+uint16_t stack_unused(void) {
+    const uint8_t *p = &_end;
+    uint16_t count = 0;
+
+    while (p <= &__stack && *p == STACK_CANARY) {
+        p ++;
+        count ++;
+    }
+
+    return count;
+}
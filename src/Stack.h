@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+
+/*
+Stack high-water mark.
+
+At boot, before any other startup code runs, every byte between the end of
+static RAM (.data and .bss) and the top of the stack is filled with a canary
+value. The stack grows down into that region and overwrites the canary as it
+goes, so the number of canary bytes still intact just above static RAM is the
+smallest the gap between the two has ever been.
+
+The firmware does not use the heap. If it ever does, heap blocks will show up
+as used stack here, which errs on the safe side.
+*/
+uint16_t stack_unused(void);
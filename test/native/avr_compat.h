@@ -0,0 +1,12 @@
+// Stand-ins for the avr-libc functions used by src/CTD.cpp, so the CTD
+// pipeline can be built natively for test/ptysim.py.
+#pragma once
+
+#include <stdio.h>
+
+
+static inline char *dtostrf(double val, signed char width, unsigned char prec,
+                            char *s) {
+    sprintf(s, "%*.*f", width, prec, val);
+    return s;
+}
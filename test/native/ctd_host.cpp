@@ -0,0 +1,99 @@
+// Native host for the CTD pipeline, driven by test/ptysim.py.
+//
+// Reads CTD lines from a serial device (normally one end of a pty pair) and
+// writes the averaged records back to it. Input is handed to handle_ctd_input()
+// the way append_file() does on the OpenLog: characters collect in a 128-byte
+// buffer until a read brings a newline or fills it, and a partial line is
+// flushed once the input has been idle for 500 ms. (The OpenLog only notices
+// the idle time on its next 1 Hz wakeup, so there it takes 0.5 to 1.5 s.)
+//
+// The OpenLog's serial buffer, SD card and output schedule are not modelled.
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "CTD.h"
+
+
+// Same as the local buffer and idle timeout in append_file()
+#define LOCAL_BUFF_SIZE 128
+#define MAX_IDLE_MS 500
+
+
+static int fd = -1;
+
+
+static size_t write_record(const char *str) {
+    size_t len = strlen(str);
+    size_t done = 0;
+
+    while (done < len) {
+        ssize_t n = write(fd, str + done, len - done);
+        if (n < 0)
+            return done;
+        done += n;
+    }
+    return done;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s DEVICE\n", argv[0]);
+        return 2;
+    }
+
+    fd = open(argv[1], O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    char buffer[LOCAL_BUFF_SIZE];
+    size_t buffered = 0;
+    struct pollfd pfd = { fd, POLLIN, 0 };
+
+    while (1) {
+        int ready = poll(&pfd, 1, MAX_IDLE_MS);
+        if (ready < 0)
+            break;
+
+        if (ready == 0) {
+            // Idle: hand over the partial line, as the OpenLog does before
+            // syncing the card. The CTD handler keeps it until the rest comes.
+            if (buffered > 0) {
+                handle_ctd_input(write_record, buffer, buffered);
+                buffered = 0;
+            }
+            continue;
+        }
+
+        ssize_t n = read(fd, buffer + buffered, sizeof(buffer) - buffered);
+        if (n <= 0)
+            break;
+
+        int end_of_line = memchr(buffer + buffered, '\n', n) != NULL;
+        buffered += n;
+
+        // Wait for the rest of the line
+        if (!end_of_line && buffered < sizeof(buffer))
+            continue;
+
+        handle_ctd_input(write_record, buffer, buffered);
+        buffered = 0;
+    }
+
+    if (buffered > 0)
+        handle_ctd_input(write_record, buffer, buffered);
+
+    return 0;
+}
@@ -0,0 +1,410 @@
+#!/usr/bin/env python3
+"""
+End-to-end test of the CTD pipeline over a pseudo-terminal.
+
+Builds src/CTD.cpp natively together with test/native/ctd_host.cpp, connects
+it to one end of a pty pair, and plays a simulated SBE 49 into the other end.
+The stream can be paced at 16 Hz or faster, with timing jitter, bursts,
+dropped bytes and any mix of the optional salinity and sound velocity fields.
+
+Every averaged record is checked against a reference model of the firmware.
+The model is applied to the bytes that were actually sent, so records are
+still expected to match exactly when bytes are dropped. The test reports the
+latency from the 16th line of each window to its averaged record, and the line
+rate.
+
+    python3 test/ptysim.py --rate 16 --windows 30
+    python3 test/ptysim.py --fields none,sal,sv,both --drop 0.001 --jitter 0.01
+    python3 test/ptysim.py --ramp
+
+This exercises the line assembly, parsing and averaging code, not the AVR's
+timing: the serial buffer, SD card and output schedule exist only on the
+OpenLog. Use
+simctd.py to test the real device.
+"""
+import argparse
+import os
+import random
+import re
+import select
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+import tty
+
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# Mirrors src/CTD.cpp
+MAX_SAMPLES = 16
+RX_BUFFER_SIZE = len('ttt.tttt, cc.ccccc, pppp.ppp, sss.ssss, vvvv.vvv\n') + 1
+
+FIELD_SETS = {
+    'none': (False, False),
+    'sal': (True, False),
+    'sv': (False, True),
+    'both': (True, True),
+}
+
+
+def build(cxx, sanitize, outdir):
+    binary = os.path.join(outdir, 'ctd_host')
+    cmd = [
+        cxx, '-std=gnu++11', '-O2', '-g',
+        '-include', os.path.join(ROOT, 'test', 'native', 'avr_compat.h'),
+        '-I', os.path.join(ROOT, 'src'),
+        os.path.join(ROOT, 'src', 'CTD.cpp'),
+        os.path.join(ROOT, 'test', 'native', 'ctd_host.cpp'),
+        '-o', binary,
+    ]
+    if sanitize:
+        cmd[1:1] = ['-fsanitize=address,undefined']
+    subprocess.run(cmd, check=True)
+    return binary
+
+
+# Reference model of the firmware ----------------------------------------------
+
+def f32(value):
+    return struct.unpack('f', struct.pack('f', value))[0]
+
+
+ATOF = re.compile(rb'\s*[+-]?(\d+\.?\d*|\.\d+)([eE][+-]?\d+)?')
+
+
+def atof(token):
+    match = ATOF.match(token)
+    return float(match.group(0)) if match else 0.0
+
+
+def next_field(rest):
+    """Mirror next_field() in CTD.cpp: (field or None, remaining or None)"""
+    if rest is None:
+        return None, None
+    rest = rest.lstrip(b' ')
+    field, sep, remaining = rest.partition(b',')
+    return field, (remaining if sep else None)
+
+
+def parse_line(line):
+    rest = line
+    values = []
+    for _ in range(3):
+        field, rest = next_field(rest)
+        values.append(f32(atof(field)) if field is not None else 0.0)
+
+    salinity = sound_velocity = -9999.0
+    field, rest = next_field(rest)
+    if field is not None:
+        decimal = field.find(b'.')
+        digits = re.match(rb'\d*', field[decimal + 1:]).group(0)
+        if decimal >= 0 and len(digits) == 4:
+            salinity = f32(atof(field))
+        else:
+            sound_velocity = f32(atof(field))
+
+    field, rest = next_field(rest)
+    if field is not None:
+        sound_velocity = f32(atof(field))
+
+    return values + [salinity, sound_velocity]
+
+
+def format_record(samples):
+    sums = list(samples[0])
+    for sample in samples[1:]:
+        sums = [f32(a + b) for a, b in zip(sums, sample)]
+    avg = [f32(s / MAX_SAMPLES) for s in sums]
+
+    # Each field takes exactly 8 columns. Wider values, like the -9999
+    # placeholders, are cut off by whatever the firmware writes next.
+    fields = [f'{avg[0]:8.4f}', f'{avg[1]:8.5f}', f'{avg[2]:8.3f}',
+              f'{avg[3]:8.4f}', f'{avg[4]:8.3f}']
+    return (', '.join(f[:8] for f in fields) + '\n').encode()
+
+
+class Reference:
+    """Feeds the delivered byte stream through a model of handle_ctd_input()"""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.samples = []
+        self.records = []
+
+    def feed(self, data):
+        for byte in data:
+            if byte == ord('\n'):
+                # A NUL in the line ends it early, as in the firmware
+                line = bytes(self.buffer).split(b'\0')[0]
+                self.buffer.clear()
+                self.samples.append(parse_line(line))
+                if len(self.samples) == MAX_SAMPLES:
+                    self.records.append(format_record(self.samples))
+                    self.samples = []
+            elif len(self.buffer) < RX_BUFFER_SIZE:
+                self.buffer.append(byte)
+
+
+# Simulated CTD ------------------------------------------------------------------
+
+class SyntheticCTD:
+    """Random walk through plausible SBE 49 readings"""
+
+    def __init__(self, rng, field_sets, crlf=False):
+        self.rng = rng
+        self.field_sets = field_sets
+        self.eol = b'\r\n' if crlf else b'\n'
+        self.state = [12.0, 4.2, 100.0, 34.5, 1500.0]
+
+    def next_line(self):
+        steps = [0.01, 0.001, 0.5, 0.002, 0.05]
+        self.state = [v + self.rng.gauss(0, s)
+                      for v, s in zip(self.state, steps)]
+        self.state[2] = max(self.state[2], 0.0)
+        t, c, p, sal, sv = self.state
+
+        use_sal, use_sv = FIELD_SETS[self.rng.choice(self.field_sets)]
+        line = f'{t:8.4f}, {c:8.5f}, {p:8.3f}'
+        if use_sal:
+            line += f', {sal:8.4f}'
+        if use_sv:
+            line += f', {sv:8.3f}'
+        return line.encode() + self.eol
+
+
+class ReplayCTD:
+    """Lines from a recorded SBE 49 stream, looped
+
+    Line endings are sent as recorded, so the CR LF of a real SBE 49 reaches
+    the parser. Only a missing newline on the last line is added.
+    """
+
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.lines = [l if l.endswith(b'\n') else l + b'\n'
+                          for l in f if l.strip() and not l.startswith(b'#')]
+        if not self.lines:
+            raise SystemExit(f'{path}: no CTD lines')
+        self.index = 0
+
+    def next_line(self):
+        line = self.lines[self.index % len(self.lines)]
+        self.index += 1
+        return line
+
+
+# Test run -----------------------------------------------------------------------
+
+def run(args, binary, rate):
+    rng = random.Random(args.seed)
+    if args.replay:
+        ctd = ReplayCTD(args.replay)
+    else:
+        ctd = SyntheticCTD(rng, args.fields.split(','), args.crlf)
+
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    host = subprocess.Popen([binary, os.ttyname(slave)])
+
+    reference = Reference()
+    newline_times = []      # when each newline was written, in stream order
+    outputs = []            # (time, record) as received
+    done = threading.Event()
+
+    def reader():
+        pending = b''
+        while not done.is_set() or select.select([master], [], [], 0)[0]:
+            if not select.select([master], [], [], 0.1)[0]:
+                continue
+            try:
+                data = os.read(master, 4096)
+            except OSError:
+                break
+            now = time.monotonic()
+            pending += data
+            while b'\n' in pending:
+                record, pending = pending.split(b'\n', 1)
+                outputs.append((now, record + b'\n'))
+
+    thread = threading.Thread(target=reader, daemon=True)
+    thread.start()
+
+    # Give the host time to open the device before data arrives
+    time.sleep(0.2)
+
+    n_lines = args.windows * MAX_SAMPLES
+    period = 1 / rate
+    start = time.monotonic()
+    for i in range(n_lines):
+        # Lines go out in bursts of --burst, with the bursts spaced to keep the
+        # average rate, each offset by up to --jitter
+        if i % args.burst == 0:
+            due = start + i * period + rng.uniform(0, args.jitter)
+            delay = due - time.monotonic()
+            if delay > 0:
+                time.sleep(delay)
+
+        line = ctd.next_line()
+        if args.drop:
+            line = bytes(b for b in line if rng.random() >= args.drop)
+        if not line:
+            continue
+
+        now = time.monotonic()
+        os.write(master, line)
+        reference.feed(line)
+        newline_times.extend([now] * line.count(b'\n'))
+
+        # Emulate the time the line takes on the wire
+        if args.baud:
+            time.sleep(len(line) * 10 / args.baud)
+
+    elapsed = time.monotonic() - start
+
+    # Wait for the last records to come back
+    deadline = time.monotonic() + args.timeout
+    while len(outputs) < len(reference.records) and \
+            time.monotonic() < deadline:
+        time.sleep(0.01)
+
+    done.set()
+    thread.join()
+    host.terminate()
+    host.wait()
+    os.close(master)
+    os.close(slave)
+
+    # Compare against the reference, record by record
+    latencies = []
+    mismatches = []
+    for k, expected in enumerate(reference.records):
+        if k >= len(outputs):
+            break
+        received_at, record = outputs[k]
+        if record != expected:
+            mismatches.append((k, expected, record))
+        latencies.append(
+            received_at - newline_times[(k + 1) * MAX_SAMPLES - 1])
+
+    return {
+        'rate': rate,
+        'lines': n_lines,
+        'line_rate': n_lines / elapsed,
+        'expected': len(reference.records),
+        'received': len(outputs),
+        'mismatches': mismatches,
+        'latencies': sorted(latencies),
+        'host_status': host.returncode,
+    }
+
+
+def percentile(values, p):
+    if not values:
+        return float('nan')
+    return values[min(len(values) - 1, int(p / 100 * len(values)))]
+
+
+def report(result):
+    lat = result['latencies']
+    print(f"rate {result['rate']:g} lines/s: sent {result['lines']} lines "
+          f"at {result['line_rate']:.1f} lines/s, "
+          f"{result['received']}/{result['expected']} records, "
+          f"{len(result['mismatches'])} incorrect")
+    if lat:
+        print(f'  latency ms: min {1e3*lat[0]:.3f}  '
+              f'p50 {1e3*percentile(lat, 50):.3f}  '
+              f'p99 {1e3*percentile(lat, 99):.3f}  max {1e3*lat[-1]:.3f}')
+    for k, expected, received in result['mismatches'][:5]:
+        print(f'  record {k}: expected {expected!r}\n'
+              f'  {"":>{len(str(k)) + 8}}received {received!r}')
+
+
+def passed(result, args):
+    return (result['received'] == result['expected']
+            and not result['mismatches']
+            and result['line_rate'] >= 0.9 * result['rate']
+            and percentile(result['latencies'], 99) < args.max_latency)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument('--rate', '-r', type=float, default=16,
+                        help='lines per second (default: 16)')
+    parser.add_argument('--windows', '-n', type=int, default=10,
+                        help='averaged records to produce (default: 10)')
+    parser.add_argument('--fields', default='both',
+                        help='optional field sets to pick from at random '
+                             'for each line: none, sal, sv, both '
+                             '(default: both)')
+    parser.add_argument('--crlf', action='store_true',
+                        help='end synthetic lines with CR LF, like the SBE 49')
+    parser.add_argument('--replay', metavar='FILE',
+                        help='send lines from a recorded SBE 49 stream')
+    parser.add_argument('--jitter', type=float, default=0,
+                        help='random delay of up to this many seconds')
+    parser.add_argument('--burst', type=int, default=1,
+                        help='send lines back to back in groups of this size')
+    parser.add_argument('--drop', type=float, default=0,
+                        help='probability of dropping each byte')
+    parser.add_argument('--baud', type=int, default=0,
+                        help='also pace each line as if sent at this baud')
+    parser.add_argument('--seed', type=int, default=1)
+    parser.add_argument('--timeout', type=float, default=2,
+                        help='how long to wait for the last records')
+    parser.add_argument('--ramp', action='store_true',
+                        help='double the rate until the line rate or latency '
+                             'can no longer keep up, and report the last rate '
+                             'that did')
+    parser.add_argument('--max-latency', type=float, default=0.1,
+                        help='p99 latency in seconds above which a ramp '
+                             'step fails (default: 0.1)')
+    parser.add_argument('--cxx', default=os.environ.get('CXX', 'c++'))
+    parser.add_argument('--sanitize', action='store_true',
+                        help='build with AddressSanitizer and UBSan')
+    parser.add_argument('--binary',
+                        help='use an already built ctd_host')
+    args = parser.parse_args()
+
+    if args.burst < 1:
+        parser.error('--burst must be at least 1')
+
+    outdir = tempfile.mkdtemp(prefix='ptysim-')
+    try:
+        binary = args.binary or build(args.cxx, args.sanitize, outdir)
+
+        if not args.ramp:
+            result = run(args, binary, args.rate)
+            report(result)
+            ok = (result['received'] == result['expected']
+                  and not result['mismatches']
+                  and result['host_status'] in (0, -15))
+            return 0 if ok else 1
+
+        sustained = None
+        rate = args.rate
+        while True:
+            result = run(args, binary, rate)
+            report(result)
+            if result['mismatches'] or result['host_status'] not in (0, -15):
+                return 1
+            if not passed(result, args):
+                break
+            sustained = result['line_rate']
+            rate *= 2
+
+        if sustained is None:
+            print(f'Could not sustain {args.rate:g} lines/s')
+            return 1
+        print(f'Sustained {sustained:.0f} lines/s')
+        return 0
+    finally:
+        shutil.rmtree(outdir, ignore_errors=True)
+
+
+if __name__ == '__main__':
+    sys.exit(main())